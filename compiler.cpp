@@ -1,4 +1,5 @@
 #include <map>
+#include <set>
 #include <string>
 #include <sstream>
 #include <cstring>
@@ -35,6 +36,37 @@ char header_begin[] = R"(
 
 )";
 
+// every column of a batch container starts on a cache line boundary,
+// which is also wide enough for any SIMD register we care about
+constexpr size_t batch_alignment = 64;
+
+// batches are meant to hold a control cycle worth of samples, not a log
+constexpr size_t max_batch_capacity = 65536;
+
+char benchmark_begin[] = R"(
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "header_acessor.h"
+
+constexpr size_t benchmark_iterations = 100000;
+
+template<typename Function>
+double nanoseconds_per_sample(Function&& function, size_t samples){
+	auto start = std::chrono::steady_clock::now();
+	for(size_t iteration = 0; iteration < benchmark_iterations; ++iteration)
+		function();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double,std::nano>(end-start).count()/(benchmark_iterations*samples);
+}
+
+int main(){
+	double checksum = 0.0;
+)";
+
 struct field_description{
     std::string name;
     std::string type_name;
@@ -70,6 +102,10 @@ int main(int argc, char* argv[]){
         return 1;
     }
 
+    std::stringstream benchmark_file;
+    benchmark_file << benchmark_begin;
+    bool requested_batches = false;
+
     nlohmann::json messages;
     size_t global_memory_index = 0;
     try{
@@ -78,6 +114,16 @@ int main(int argc, char* argv[]){
         std::cout << "failed to find any messages field in the supplied json file" << std::endl;
         return 1;
     }
+    // the names of all messages are needed up front, the batch containers must not clash with them
+    std::set<std::string> message_names;
+    for(const auto & message : messages){
+        try{
+            message_names.insert(message.at("message").get<std::string>());
+        } catch (...){
+            std::cout << "the name of a supplied message is not present" << std::endl;
+            return 1;
+        }
+    }
     //lets find the message name
     for(const auto & message : messages){
         std::stringstream local_class_stream;
@@ -213,6 +259,235 @@ int main(int argc, char* argv[]){
            }
         };
         local_class_stream << "}" << std::endl;
+
+        // messages which request a batch capacity also get a structure of arrays container, where
+        // each component of each field is stored in its own aligned and contiguous column
+        size_t batch_capacity = 0;
+        if(message.contains("batch_capacity")){
+            if(!message["batch_capacity"].is_number_unsigned()){
+                std::cout << "the batch capacity of the message " << class_name << " must be a positive integer" << std::endl;
+                return 1;
+            }
+            batch_capacity = message["batch_capacity"];
+            if(batch_capacity==0 || batch_capacity>max_batch_capacity){
+                std::cout << "the batch capacity of the message " << class_name << " must be between 1 and " << max_batch_capacity << std::endl;
+                return 1;
+            }
+            for(const auto& generated_name : {class_name+"_batch",class_name+"_batch_capacity"}){
+                if(message_names.count(generated_name)!=0){
+                    std::cout << "the batch of the message " << class_name << " needs the name (" << generated_name << ") which is already used by another message. stoping compilation" << std::endl;
+                    return 1;
+                }
+            }
+            if(batch_capacity%(batch_alignment/4)!=0){
+                std::cout << "the batch capacity of the message " << class_name << " must be a multiple of " << batch_alignment/4 << " so that every column remains aligned" << std::endl;
+                return 1;
+            }
+            for(const auto& field : fiels){
+                if(field.internal_type==types::BYTES){
+                    std::cout << "the message " << class_name << " contains the bytes field (" << field.name << ") which cannot be batched. stoping compilation" << std::endl;
+                    return 1;
+                }
+                // the batch container reserves the size member, its own name, its capacity, the
+                // parameter of the column accessors and one accessor per field
+                if(field.name=="size" || field.name=="component" || field.name==class_name+"_batch" || field.name==class_name+"_batch_capacity"){
+                    std::cout << "the message " << class_name << " contains the field (" << field.name << ") whose name is reserved by the batch container. stoping compilation" << std::endl;
+                    return 1;
+                }
+                for(const auto& other : fiels){
+                    if(field.name==other.name+"_column"){
+                        std::cout << "the message " << class_name << " contains the field (" << field.name << ") which clashes with the column accessor of the field (" << other.name << "). stoping compilation" << std::endl;
+                        return 1;
+                    }
+                }
+            }
+        }
+
+        if(batch_capacity!=0){
+            requested_batches = true;
+            std::string batch_name = class_name + "_batch";
+            std::string capacity_name = class_name + "_batch_capacity";
+
+            local_class_stream << "\n\nconstexpr size_t " << capacity_name << " = " << batch_capacity << ";\n\n";
+            local_class_stream << "struct " << batch_name << "\n{\n";
+            local_class_stream << "\tsize_t size = 0;\n";
+            for(const auto& field : fiels){
+                if(field.array==1){
+                    local_class_stream << "\talignas(" << batch_alignment << ") " << field.type_name << " " << field.name << "[" << capacity_name << "];\n";
+                } else {
+                    local_class_stream << "\talignas(" << batch_alignment << ") " << field.type_name << " " << field.name << "[" << field.array << "][" << capacity_name << "];\n";
+                }
+            }
+            local_class_stream << "\n";
+            for(const auto& field : fiels){
+                if(field.array==1){
+                    local_class_stream << "\tinline " << field.type_name << "* " << field.name << "_column(){\n"
+                                       << "\t\treturn " << field.name << ";\n"
+                                       << "\t}\n\n"
+                                       << "\tinline const " << field.type_name << "* " << field.name << "_column() const {\n"
+                                       << "\t\treturn " << field.name << ";\n"
+                                       << "\t}\n\n";
+                } else {
+                    local_class_stream << "\tinline " << field.type_name << "* " << field.name << "_column(size_t component){\n"
+                                       << "\t\tassert( component < " << field.array << ");\n"
+                                       << "\t\treturn " << field.name << "[component];\n"
+                                       << "\t}\n\n"
+                                       << "\tinline const " << field.type_name << "* " << field.name << "_column(size_t component) const {\n"
+                                       << "\t\tassert( component < " << field.array << ");\n"
+                                       << "\t\treturn " << field.name << "[component];\n"
+                                       << "\t}\n\n";
+                }
+            }
+            local_class_stream << "};\n\n";
+
+            // conversion of a single sample into and out of an occupied slot of the batch,
+            // the batch only grows through push_back or the array conversion
+            local_class_stream << "inline void copy_from_" << class_name << "_to_" << batch_name << "( const " << class_name << " & tmp , " << batch_name << " & batch , size_t index)\n"
+                               << "{\n\tassert( index < batch.size);\n";
+            for(const auto& field : fiels){
+                if(field.array==1){
+                    local_class_stream << "\tbatch." << field.name << "[index] = tmp." << field.name << ";\n";
+                } else {
+                    local_class_stream << "\tfor(size_t component = 0; component < " << field.array << "; ++component)\n"
+                                       << "\t\tbatch." << field.name << "[component][index] = tmp." << field.name << "[component];\n";
+                }
+            }
+            local_class_stream << "}\n\n";
+
+            local_class_stream << "inline void copy_from_" << batch_name << "_to_" << class_name << "( const " << batch_name << " & batch , size_t index , " << class_name << " & tmp)\n"
+                               << "{\n\tassert( index < batch.size);\n";
+            for(const auto& field : fiels){
+                if(field.array==1){
+                    local_class_stream << "\ttmp." << field.name << " = batch." << field.name << "[index];\n";
+                } else {
+                    local_class_stream << "\tfor(size_t component = 0; component < " << field.array << "; ++component)\n"
+                                       << "\t\ttmp." << field.name << "[component] = batch." << field.name << "[component][index];\n";
+                }
+            }
+            local_class_stream << "}\n\n";
+
+            local_class_stream << "inline bool push_back_" << class_name << "( " << batch_name << " & batch , const " << class_name << " & tmp)\n"
+                               << "{\n"
+                               << "\tif(batch.size >= " << capacity_name << ")\n"
+                               << "\t\treturn false;\n"
+                               << "\t++batch.size;\n"
+                               << "\tcopy_from_" << class_name << "_to_" << batch_name << "(tmp,batch,batch.size-1);\n"
+                               << "\treturn true;\n"
+                               << "}\n\n";
+
+            // conversion of whole arrays of samples, walking one column at a time
+            local_class_stream << "inline void copy_from_" << class_name << "_array_to_" << batch_name << "( const " << class_name << " * samples , size_t count , " << batch_name << " & batch)\n"
+                               << "{\n\tassert( count <= " << capacity_name << ");\n";
+            for(const auto& field : fiels){
+                if(field.array==1){
+                    local_class_stream << "\tfor(size_t index = 0; index < count; ++index)\n"
+                                       << "\t\tbatch." << field.name << "[index] = samples[index]." << field.name << ";\n";
+                } else {
+                    local_class_stream << "\tfor(size_t component = 0; component < " << field.array << "; ++component)\n"
+                                       << "\t\tfor(size_t index = 0; index < count; ++index)\n"
+                                       << "\t\t\tbatch." << field.name << "[component][index] = samples[index]." << field.name << "[component];\n";
+                }
+            }
+            local_class_stream << "\tbatch.size = count;\n}\n\n";
+
+            local_class_stream << "inline void copy_from_" << batch_name << "_to_" << class_name << "_array( const " << batch_name << " & batch , " << class_name << " * samples)\n"
+                               << "{\n";
+            for(const auto& field : fiels){
+                if(field.array==1){
+                    local_class_stream << "\tfor(size_t index = 0; index < batch.size; ++index)\n"
+                                       << "\t\tsamples[index]." << field.name << " = batch." << field.name << "[index];\n";
+                } else {
+                    local_class_stream << "\tfor(size_t component = 0; component < " << field.array << "; ++component)\n"
+                                       << "\t\tfor(size_t index = 0; index < batch.size; ++index)\n"
+                                       << "\t\t\tsamples[index]." << field.name << "[component] = batch." << field.name << "[component][index];\n";
+                }
+            }
+            local_class_stream << "}" << std::endl;
+
+            // the benchmark computes the squared norm of every sample over all of its floating point
+            // components, once over the array of structs and once over the structure of arrays
+            std::stringstream aos_kernel;
+            std::stringstream soa_kernel;
+            std::stringstream fill;
+            for(const auto& field : fiels){
+                bool floating = field.internal_type==types::DOUBLE || field.internal_type==types::FLOAT;
+                if(field.array==1){
+                    fill << "\t\t\taos[index]." << field.name << " = static_cast<" << field.type_name << ">(index%7);\n";
+                    if(!floating)
+                        continue;
+                    aos_kernel << "\t\t\t\tenergy += static_cast<double>(sample." << field.name << ")*sample." << field.name << ";\n";
+                    soa_kernel << "\t\t\t{\n"
+                               << "\t\t\t\tconst " << field.type_name << "* column = soa->" << field.name << "_column();\n"
+                               << "\t\t\t\tfor(size_t index = 0; index < count; ++index)\n"
+                               << "\t\t\t\t\tenergies[index] += static_cast<double>(column[index])*column[index];\n"
+                               << "\t\t\t}\n";
+                } else {
+                    fill << "\t\t\tfor(size_t component = 0; component < " << field.array << "; ++component)\n"
+                         << "\t\t\t\taos[index]." << field.name << "[component] = static_cast<" << field.type_name << ">((index+component)%7);\n";
+                    if(!floating)
+                        continue;
+                    aos_kernel << "\t\t\t\tfor(size_t component = 0; component < " << field.array << "; ++component)\n"
+                               << "\t\t\t\t\tenergy += static_cast<double>(sample." << field.name << "[component])*sample." << field.name << "[component];\n";
+                    soa_kernel << "\t\t\tfor(size_t component = 0; component < " << field.array << "; ++component){\n"
+                               << "\t\t\t\tconst " << field.type_name << "* column = soa->" << field.name << "_column(component);\n"
+                               << "\t\t\t\tfor(size_t index = 0; index < count; ++index)\n"
+                               << "\t\t\t\t\tenergies[index] += static_cast<double>(column[index])*column[index];\n"
+                               << "\t\t\t}\n";
+                }
+            }
+
+            // messages without floating point fields have no norm to compute, so only the conversions are timed
+            bool has_floating_fields = !aos_kernel.str().empty();
+            benchmark_file << "\t{\n"
+                           << "\t\tstd::vector<" << class_name << "> aos(" << capacity_name << ");\n"
+                           << "\t\tstd::unique_ptr<" << batch_name << "> soa = std::make_unique<" << batch_name << ">();\n"
+                           << "\t\tfor(size_t index = 0; index < aos.size(); ++index){\n"
+                           << fill.str()
+                           << "\t\t}\n"
+                           << "\t\tcopy_from_" << class_name << "_array_to_" << batch_name << "(aos.data(),aos.size(),*soa);\n\n";
+            if(has_floating_fields){
+                benchmark_file << "\t\t// both kernels accumulate into the norms so that no iteration can be hoisted out of the timing loop\n"
+                               << "\t\tstd::vector<double> energies(" << capacity_name << ");\n"
+                               << "\t\tauto aos_norm = [&](){\n"
+                               << "\t\t\tfor(size_t index = 0; index < aos.size(); ++index){\n"
+                               << "\t\t\t\tconst " << class_name << "& sample = aos[index];\n"
+                               << "\t\t\t\tdouble energy = 0.0;\n"
+                               << aos_kernel.str()
+                               << "\t\t\t\tenergies[index] += energy;\n"
+                               << "\t\t\t}\n"
+                               << "\t\t};\n"
+                               << "\t\tauto soa_norm = [&](){\n"
+                               << "\t\t\tconst size_t count = soa->size;\n"
+                               << soa_kernel.str()
+                               << "\t\t};\n\n"
+                               << "\t\tstd::fill(energies.begin(),energies.end(),0.0);\n"
+                               << "\t\taos_norm();\n"
+                               << "\t\tfor(const auto& energy : energies)\n"
+                               << "\t\t\tchecksum += energy;\n"
+                               << "\t\tstd::fill(energies.begin(),energies.end(),0.0);\n"
+                               << "\t\tsoa_norm();\n"
+                               << "\t\tfor(const auto& energy : energies)\n"
+                               << "\t\t\tchecksum -= energy;\n\n"
+                               << "\t\tdouble aos_filter = nanoseconds_per_sample(aos_norm,aos.size());\n"
+                               << "\t\tdouble soa_filter = nanoseconds_per_sample(soa_norm,soa->size);\n\n";
+            }
+            benchmark_file << "\t\t// the conversions are idempotent, reading the samples through a volatile pointer keeps them in the timing loop\n"
+                           << "\t\t" << class_name << "* volatile samples = aos.data();\n"
+                           << "\t\tdouble to_batch = nanoseconds_per_sample([&](){\n"
+                           << "\t\t\tcopy_from_" << class_name << "_array_to_" << batch_name << "(samples,aos.size(),*soa);\n"
+                           << "\t\t},aos.size());\n\n"
+                           << "\t\tdouble from_batch = nanoseconds_per_sample([&](){\n"
+                           << "\t\t\tcopy_from_" << batch_name << "_to_" << class_name << "_array(*soa,samples);\n"
+                           << "\t\t},aos.size());\n\n"
+                           << "\t\tstd::cout << \"" << class_name << " (\" << " << capacity_name << " << \" samples)\\n\"\n";
+            if(has_floating_fields){
+                benchmark_file << "\t\t          << \"\\tarray of structs squared norm : \" << aos_filter << \" ns per sample\\n\"\n"
+                               << "\t\t          << \"\\tstructure of arrays squared norm : \" << soa_filter << \" ns per sample\\n\"\n";
+            }
+            benchmark_file << "\t\t          << \"\\tconversion to batch : \" << to_batch << \" ns per sample\\n\"\n"
+                           << "\t\t          << \"\\tconversion from batch : \" << from_batch << \" ns per sample\" << std::endl;\n"
+                           << "\t}\n";
+        }
         header_file << local_class_stream.str();
     }
 
@@ -280,5 +555,14 @@ int main(int argc, char* argv[]){
     std::ofstream ostrmcreate("header_creator.h", std::ios::out);
     ostrmcreate << out_header_file_create.str() << std::endl;
 
+    if(requested_batches){
+        benchmark_file << "\t// both layouts must produce the same norms, so this should print zero\n"
+                       << "\tstd::cout << \"checksum : \" << checksum << std::endl;\n"
+                       << "\treturn 0;\n"
+                       << "}" << std::endl;
+        std::ofstream ostrmbenchmark("batch_benchmark.cpp", std::ios::out);
+        ostrmbenchmark << benchmark_file.str() << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file